@@ -0,0 +1,69 @@
+/**
+ *   stringEXT - string.h extended
+ *   Developed by Christian Visintin
+ *
+ * MIT License
+ * Copyright (c) 2018 Christian Visintin
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#ifndef STRPIPE_H
+#define STRPIPE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Stage rewrites the line in place and never changes its length (e.g. toLowerCase)
+#define STRPIPE_INPLACE 0x01
+
+typedef struct StrPipe StrPipe;
+
+//A stage transforms the NULL terminated line (without its newline) in *line, updating *line if it reallocates it.
+//Returns 0 on success; on error it sets errno and leaves *line allocated
+typedef int (*StrPipeStageFn)(char** line, void* arg);
+
+//Argument of strpipeReplaceAll
+typedef struct StrPipeReplace {
+  char* oldStr;
+  char* newStr;
+} StrPipeReplace;
+
+//Argument of strpipeSplitJoin
+typedef struct StrPipeSplitJoin {
+  char* splitDelimiter;
+  char* joinDelimiter;
+} StrPipeSplitJoin;
+
+StrPipe* strpipeCreate(size_t chunkSize, int ringDepth, int workers);
+int strpipeAddStage(StrPipe* pipe, StrPipeStageFn stage, void* arg, int flags);
+int strpipeRun(StrPipe* pipe, int infd, int outfd);
+void strpipeDestroy(StrPipe* pipe);
+
+int strpipeLowerCase(char** line, void* arg);
+int strpipeUpperCase(char** line, void* arg);
+int strpipeTrim(char** line, void* arg);
+int strpipeReplaceAll(char** line, void* arg);
+int strpipeSplitJoin(char** line, void* arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -137,29 +137,32 @@ int startsWith(char* haystack, char* needle) {
 
 char* replace(char* str, char* oldChar, char* newChar) {
 
-  size_t newSize = strlen(str);
-  //Calc new size for reallocation
-  if (strlen(newChar) > strlen(oldChar)) {
-    newSize = strlen(str) + (strlen(newChar) - strlen(oldChar));
-  } else if (strlen(newChar) < strlen(oldChar)) {
-    newSize = strlen(str) - (strlen(oldChar) - strlen(newChar));
+  //Get index of old char
+  int indexOldChar = indexOf(str, oldChar);
+  if (indexOldChar == -1) {
+    return str;
   }
-  //Check if str has to be reallocated
-  if (newSize > 0) {
+  size_t strLength = strlen(str);
+  size_t oldLength = strlen(oldChar);
+  size_t newLength = strlen(newChar);
+  size_t newSize = strLength - oldLength + newLength;
+  //Grow str before moving its content forward
+  if (newSize > strLength) {
     str = (char*)realloc(str, newSize + 1);
     if (str == NULL) {
       return NULL;
     }
   }
-  //Get index of old char
-  int indexOldChar = indexOf(str, oldChar);
-  if (indexOldChar != -1) {
-    //Move content forward of n positions
-    memcpy(str + indexOldChar + strlen(newChar), str + indexOldChar + strlen(oldChar), strlen(str) - (indexOldChar + strlen(oldChar)));
-    memcpy(str + indexOldChar, newChar, strlen(newChar));
+  //Move content after oldChar (ranges overlap); NULL terminator included
+  memmove(str + indexOldChar + newLength, str + indexOldChar + oldLength, strLength - (indexOldChar + oldLength) + 1);
+  memcpy(str + indexOldChar, newChar, newLength);
+  //Shrink str once its content has been moved backward; if realloc fails keep the larger block
+  if (newSize < strLength) {
+    char* shrunk = (char*)realloc(str, newSize + 1);
+    if (shrunk != NULL) {
+      str = shrunk;
+    }
   }
-  //NULL terminator
-  str[newSize] = 0x00;
   return str;
 }
 
@@ -215,8 +218,9 @@ char* substring(char* str, int beginIndex, int endIndex) {
 **/
 
 char* toLowerCase(char* str) {
-  for (int i = 0; i < strlen(str); i++)
-    str[i] = tolower(str[i]);
+  size_t strLength = strlen(str);
+  for (size_t i = 0; i < strLength; i++)
+    str[i] = tolower((unsigned char)str[i]);
   return str;
 }
 
@@ -227,8 +231,9 @@ char* toLowerCase(char* str) {
 **/
 
 char* toUpperCase(char* str) {
-  for (int i = 0; i < strlen(str); i++)
-    str[i] = toupper(str[i]);
+  size_t strLength = strlen(str);
+  for (size_t i = 0; i < strLength; i++)
+    str[i] = toupper((unsigned char)str[i]);
   return str;
 }
 
@@ -297,44 +302,41 @@ int isPalindrome(char* str) {
 
 char** strsplit(int* tokenCount, char* haystack, char* delimiter) {
 
-  //Count occurrences of delimiter in str
-  int occurrences = count(haystack, delimiter);
+  size_t haystackLength = strlen(haystack);
+  size_t delimiterLength = strlen(delimiter);
+  //Count occurrences of delimiter in str; they can't overlap, since each one ends a token
+  int occurrences = 0;
+  char* lastEnd = NULL;
+  for (char* ptr = strstr(haystack, delimiter); ptr != NULL; ptr = strstr(lastEnd, delimiter)) {
+    occurrences++;
+    lastEnd = ptr + delimiterLength;
+  }
   *tokenCount = occurrences;
   //If haystack ends with delimiter tokens = occurrences, otherwise is occurrences + 1
-  if (endsWith(haystack, delimiter) != 0) {
+  if (lastEnd != haystack + haystackLength) {
     (*tokenCount)++;
   }
   //Allocate tokens
-  char** tokens = malloc(sizeof(char*) * *tokenCount);
-  int indexPtr = 0;
-  int currIndex = 0;
-  for (int i = 0; i < occurrences; i++) {
-    //Get token
-    currIndex += indexPtr;
-    indexPtr = indexOf(haystack + currIndex, delimiter);
-    char* tok = substr(haystack + currIndex, 0, indexPtr);
-    indexPtr++; //Ignore delimiter position
-    //Store in ith position tok
-    size_t tokLength = strlen(tok);
-    *(tokens + i) = (char*)calloc(1, sizeof(char) * (tokLength + 1));
-    if ((tokens + occurrences) == NULL) {
-      return NULL;
-    }
-    memcpy(*(tokens + i), tok, tokLength);
-    free(tok);
+  char** tokens = (char**)malloc(sizeof(char*) * *tokenCount);
+  if (tokens == NULL) {
+    return NULL;
   }
-
-  //Get last token if tokenCount > occurrences
-  if (*tokenCount > occurrences) {
-    //Last token is from lastIndexOf(delimiter) + 1 to its end; works also if string has no occurrences of delimiter in it
-    char* tok = substring(haystack, lastIndexOf(haystack, delimiter) + 1, strlen(haystack));
-    size_t tokLength = strlen(tok);
-    *(tokens + occurrences) = (char*)calloc(1, sizeof(char) * (tokLength + 1));
-    if ((tokens + occurrences) == NULL) {
+  char* tokenStart = haystack;
+  for (int i = 0; i < *tokenCount; i++) {
+    //Last token goes up to the end of haystack
+    char* tokenEnd = strstr(tokenStart, delimiter);
+    if (tokenEnd == NULL) {
+      tokenEnd = haystack + haystackLength;
+    }
+    *(tokens + i) = substr(tokenStart, 0, tokenEnd - tokenStart);
+    if (*(tokens + i) == NULL) {
+      for (int j = 0; j < i; j++) {
+        free(*(tokens + j));
+      }
+      free(tokens);
       return NULL;
     }
-    memcpy(*(tokens + occurrences), tok, tokLength);
-    free(tok);
+    tokenStart = tokenEnd + delimiterLength; //Skip the whole delimiter
   }
   return tokens;
 }
@@ -389,20 +391,16 @@ char* strjoin(char** tokens, int tokenCount, char* delimiter) {
 
 char* ltrim(char* str) {
   //Count whitespaces at the left of the string
-  int ptri = 0;
-  while (str[ptri] == 0x20 && ptri < strlen(str))
+  size_t strLength = strlen(str);
+  size_t ptri = 0;
+  while (ptri < strLength && str[ptri] == 0x20)
     ptri++;
-  size_t newSize = strlen(str) - ptri;
-  char* tmpSrc = (char*)malloc(sizeof(char) * newSize);
-  memcpy(tmpSrc, str + ptri, newSize);
-  str = (char*)realloc(str, sizeof(char) * newSize + 1);
-  if (str == NULL) {
-    return NULL;
-  }
-  memcpy(str, tmpSrc, newSize);
-  str[newSize] = 0x00;
-  free(tmpSrc);
-  return str;
+  size_t newSize = strLength - ptri;
+  //Move content backward, NULL terminator included
+  memmove(str, str + ptri, newSize + 1);
+  //Shrinking can't lose content; if realloc fails keep the larger block
+  char* shrunk = (char*)realloc(str, sizeof(char) * newSize + 1);
+  return shrunk != NULL ? shrunk : str;
 }
 
 /**
@@ -413,19 +411,13 @@ char* ltrim(char* str) {
 
 char* rtrim(char* str) {
   //Count whitespaces at the right of the string
-  int ptri = strlen(str) - 1;
-  int wCount = 0;
-  while (str[ptri] == 0x20 && ptri >= 0) {
-    ptri--;
-    wCount++;
-  }
-  size_t newSize = strlen(str) - wCount;
-  str = (char*)realloc(str, sizeof(char) * newSize + 1);
-  if (str == NULL) {
-    return NULL;
-  }
+  size_t newSize = strlen(str);
+  while (newSize > 0 && str[newSize - 1] == 0x20)
+    newSize--;
   str[newSize] = 0x00;
-  return str;
+  //Shrinking can't lose content; if realloc fails keep the larger block
+  char* shrunk = (char*)realloc(str, sizeof(char) * newSize + 1);
+  return shrunk != NULL ? shrunk : str;
 }
 
 /**
@@ -0,0 +1,940 @@
+/**
+ *   stringEXT - string.h extended
+ *   Developed by Christian Visintin
+ *
+ * MIT License
+ * Copyright (c) 2018 Christian Visintin
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#define _GNU_SOURCE
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "strpipe.h"
+#include "stringext.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#define STRPIPE_DEFAULT_CHUNK (1024 * 1024)
+#define STRPIPE_MIN_CHUNK 4096
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/**
+ * Every slot of the ring goes FREE -> READING -> READ -> TRANSFORMING -> DONE -> FREE.
+ * The reader fills slots in order, workers transform them in any order, the writer
+ * drains them in order; a slot is reused only once the writer has released it
+**/
+
+enum { SLOT_FREE, SLOT_READING, SLOT_READ, SLOT_TRANSFORMING, SLOT_DONE };
+
+typedef struct StrPipeStage {
+  StrPipeStageFn fn;
+  void* arg;
+  int flags;
+} StrPipeStage;
+
+typedef struct StrPipeSlot {
+  int state;
+  size_t seq;
+  char* buf;    //headroom + chunk + NULL terminator; reads land at buf + headroom
+  char* spill;  //carry buffer handed over when the carried partial line doesn't fit the headroom
+  char* data;   //first byte of the chunk lines
+  size_t len;   //length of data, up to and including its last newline
+  int pending;  //io_uring read in flight
+  int res;      //io_uring read result
+  struct iovec* iov;
+  size_t iovCount;
+  size_t iovSize;
+  char** lines; //lines reallocated by the stages, released after write
+  size_t lineCount;
+  size_t lineSize;
+} StrPipeSlot;
+
+struct StrPipe {
+  size_t chunkSize;
+  size_t headroom;
+  int depth;
+  int workers;
+  StrPipeStage* stages;
+  int stageCount;
+  StrPipeSlot* slots;
+  //Run state, guarded by lock
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  size_t published;
+  size_t nextTransform;
+  int readDone;
+  int error;
+  //Reader state
+  int infd;
+  int outfd;
+  off_t base;
+  int seekable;
+  char* carry;
+  size_t carryLen;
+  size_t carrySize;
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+  int useUring;
+#endif
+};
+
+static char newline[] = "\n";
+
+/**
+ * Returns the input offset of a chunk
+ * @param StrPipe*: pipeline
+ * @param size_t: chunk sequence number
+ * @returns off_t: offset of the first byte of the chunk
+**/
+
+static off_t chunkOffset(StrPipe* pipe, size_t seq) {
+  return pipe->base + (off_t)seq * (off_t)pipe->chunkSize;
+}
+
+/**
+ * Returns the last newline in a buffer
+ * @param char*: buffer
+ * @param size_t: length of buffer
+ * @returns char*: pointer to the last newline. NULL if not found
+**/
+
+static char* lastNewline(char* buf, size_t len) {
+#ifdef HAVE_MEMRCHR
+  return (char*)memrchr(buf, '\n', len);
+#else
+  while (len > 0) {
+    if (buf[--len] == '\n') {
+      return buf + len;
+    }
+  }
+  return NULL;
+#endif
+}
+
+/**
+ * Records the first error of the run and wakes up every stage so it can bail out
+ * @param StrPipe*: pipeline
+ * @param int: errno value
+**/
+
+static void setError(StrPipe* pipe, int error) {
+  pthread_mutex_lock(&pipe->lock);
+  if (pipe->error == 0) {
+    pipe->error = error;
+  }
+  pthread_cond_broadcast(&pipe->cond);
+  pthread_mutex_unlock(&pipe->lock);
+}
+
+/**
+ * Creates a new pipeline
+ * @param size_t: size of the chunks the input is read in; 0 for default (1MB)
+ * @param int: amount of chunks which can be in flight at once; 0 for default (2 per worker + 2)
+ * @param int: amount of transform threads; 0 for one per online CPU
+ * @returns StrPipe*: pointer to the new pipeline. NULL in case of error
+**/
+
+StrPipe* strpipeCreate(size_t chunkSize, int ringDepth, int workers) {
+
+  if (chunkSize == 0) {
+    chunkSize = STRPIPE_DEFAULT_CHUNK;
+  } else if (chunkSize < STRPIPE_MIN_CHUNK) {
+    chunkSize = STRPIPE_MIN_CHUNK;
+  }
+  if (workers <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = cpus > 0 ? (int)cpus : 1;
+  }
+  //Reader and writer hold a slot each while workers hold the others
+  if (ringDepth <= 0) {
+    ringDepth = workers * 2 + 2;
+  } else if (ringDepth < 2) {
+    ringDepth = 2;
+  }
+
+  StrPipe* pipe = (StrPipe*)calloc(1, sizeof(StrPipe));
+  if (pipe == NULL) {
+    return NULL;
+  }
+  pipe->chunkSize = chunkSize;
+  //Partial lines carried to the next chunk are copied before it; longer ones are built in the carry buffer
+  pipe->headroom = chunkSize / 4;
+  pipe->depth = ringDepth;
+  pipe->workers = workers;
+  pthread_mutex_init(&pipe->lock, NULL);
+  pthread_cond_init(&pipe->cond, NULL);
+  pipe->slots = (StrPipeSlot*)calloc(ringDepth, sizeof(StrPipeSlot));
+  if (pipe->slots == NULL) {
+    strpipeDestroy(pipe);
+    return NULL;
+  }
+  for (int i = 0; i < ringDepth; i++) {
+    pipe->slots[i].buf = (char*)malloc(sizeof(char) * (pipe->headroom + chunkSize + 1));
+    if (pipe->slots[i].buf == NULL) {
+      strpipeDestroy(pipe);
+      return NULL;
+    }
+  }
+  return pipe;
+}
+
+/**
+ * Appends a stage to the pipeline. Stages are applied to each line in the order they were added
+ * NOTE: stages without STRPIPE_INPLACE receive a malloc'd line they may realloc or replace (freeing the old one), updating *line;
+ * STRPIPE_INPLACE stages may be handed a line inside the read buffer, so they must not realloc it nor change its length.
+ * If a stage fails the line left in *line is freed and the run stops with the errno set by the stage.
+ * Lines are NULL terminated strings: a line containing a NUL byte is cut at it once a stage without STRPIPE_INPLACE has run
+ * @param StrPipe*: pipeline
+ * @param StrPipeStageFn: stage function
+ * @param void*: argument passed to the stage function
+ * @param int: stage flags (STRPIPE_INPLACE)
+ * @returns int: 0 if the stage has been added
+**/
+
+int strpipeAddStage(StrPipe* pipe, StrPipeStageFn stage, void* arg, int flags) {
+
+  StrPipeStage* stages = (StrPipeStage*)realloc(pipe->stages, sizeof(StrPipeStage) * (pipe->stageCount + 1));
+  if (stages == NULL) {
+    return 1;
+  }
+  stages[pipe->stageCount].fn = stage;
+  stages[pipe->stageCount].arg = arg;
+  stages[pipe->stageCount].flags = flags;
+  pipe->stages = stages;
+  pipe->stageCount++;
+  return 0;
+}
+
+/**
+ * Releases the output of a slot and hands it back to the reader
+ * @param StrPipeSlot*: slot to release
+**/
+
+static void releaseSlot(StrPipeSlot* slot) {
+  for (size_t i = 0; i < slot->lineCount; i++) {
+    free(slot->lines[i]);
+  }
+  slot->lineCount = 0;
+  slot->iovCount = 0;
+  free(slot->spill);
+  slot->spill = NULL;
+  slot->state = SLOT_FREE;
+}
+
+/**
+ * Frees the pipeline
+ * @param StrPipe*: pipeline to free
+**/
+
+void strpipeDestroy(StrPipe* pipe) {
+
+  if (pipe == NULL) {
+    return;
+  }
+  if (pipe->slots != NULL) {
+    for (int i = 0; i < pipe->depth; i++) {
+      releaseSlot(&pipe->slots[i]);
+      free(pipe->slots[i].buf);
+      free(pipe->slots[i].iov);
+      free(pipe->slots[i].lines);
+    }
+  }
+  pthread_mutex_destroy(&pipe->lock);
+  pthread_cond_destroy(&pipe->cond);
+  free(pipe->slots);
+  free(pipe->stages);
+  free(pipe->carry);
+  free(pipe);
+}
+
+/**
+ * Reads synchronously until count bytes have been read or the end of the input is reached
+ * @param StrPipe*: pipeline
+ * @param char*: destination buffer
+ * @param size_t: amount of bytes to read
+ * @param off_t: input offset to read from (ignored if the input is not seekable)
+ * @returns ssize_t: amount of bytes read. -1 in case of error
+**/
+
+static ssize_t readFull(StrPipe* pipe, char* dest, size_t count, off_t offset) {
+
+  size_t total = 0;
+  while (total < count) {
+    ssize_t n;
+    if (pipe->seekable) {
+      n = pread(pipe->infd, dest + total, count - total, offset + total);
+    } else {
+      n = read(pipe->infd, dest + total, count - total);
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += n;
+  }
+  return total;
+}
+
+/**
+ * Starts reading the chunk assigned to slot. Without io_uring the read happens in readerComplete
+ * @param StrPipe*: pipeline
+ * @param StrPipeSlot*: slot to read into
+ * @returns int: 0 if the read has been submitted
+**/
+
+static int readerSubmit(StrPipe* pipe, StrPipeSlot* slot) {
+
+#ifdef HAVE_LIBURING
+  if (pipe->useUring) {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&pipe->ring);
+    if (sqe == NULL) {
+      errno = EBUSY;
+      return 1;
+    }
+    io_uring_prep_read(sqe, pipe->infd, slot->buf + pipe->headroom, pipe->chunkSize, chunkOffset(pipe, slot->seq));
+    io_uring_sqe_set_data(sqe, slot);
+    slot->pending = 1;
+    int rc = io_uring_submit(&pipe->ring);
+    if (rc < 0) {
+      slot->pending = 0;
+      errno = -rc;
+      return 1;
+    }
+  }
+#else
+  (void)pipe;
+  (void)slot;
+#endif
+  return 0;
+}
+
+/**
+ * Waits for the read of slot to complete
+ * NOTE: a short read is completed synchronously, so fewer than chunkSize bytes always means end of input
+ * @param StrPipe*: pipeline
+ * @param StrPipeSlot*: slot being read
+ * @returns ssize_t: amount of bytes read. -1 in case of error
+**/
+
+static ssize_t readerComplete(StrPipe* pipe, StrPipeSlot* slot) {
+
+  char* dest = slot->buf + pipe->headroom;
+  off_t offset = chunkOffset(pipe, slot->seq);
+#ifdef HAVE_LIBURING
+  if (pipe->useUring) {
+    //Completions come in any order; park each result in its slot until ours shows up
+    while (slot->pending) {
+      struct io_uring_cqe* cqe;
+      int rc = io_uring_wait_cqe(&pipe->ring, &cqe);
+      if (rc < 0) {
+        if (rc == -EINTR) {
+          continue;
+        }
+        errno = -rc;
+        return -1;
+      }
+      StrPipeSlot* done = (StrPipeSlot*)io_uring_cqe_get_data(cqe);
+      done->res = cqe->res;
+      done->pending = 0;
+      io_uring_cqe_seen(&pipe->ring, cqe);
+    }
+    if (slot->res < 0) {
+      errno = -slot->res;
+      return -1;
+    }
+    if (slot->res == 0 || (size_t)slot->res == pipe->chunkSize) {
+      return slot->res;
+    }
+    ssize_t rest = readFull(pipe, dest + slot->res, pipe->chunkSize - slot->res, offset + slot->res);
+    return rest < 0 ? -1 : slot->res + rest;
+  }
+#endif
+  return readFull(pipe, dest, pipe->chunkSize, offset);
+}
+
+/**
+ * Appends bytes to the partial line carried to the next chunk, growing the carry buffer geometrically
+ * @param StrPipe*: pipeline
+ * @param char*: bytes to append
+ * @param size_t: amount of bytes
+ * @returns int: 0 on success
+**/
+
+static int carryAppend(StrPipe* pipe, char* bytes, size_t len) {
+
+  if (len == 0) {
+    return 0;
+  }
+  //Keep room for the NULL terminator in case the carry buffer is handed over to a slot
+  if (pipe->carryLen + len + 1 > pipe->carrySize) {
+    size_t size = pipe->carrySize * 2;
+    if (size < pipe->carryLen + len + 1) {
+      size = pipe->carryLen + len + 1;
+    }
+    char* carry = (char*)realloc(pipe->carry, sizeof(char) * size);
+    if (carry == NULL) {
+      errno = ENOMEM;
+      return 1;
+    }
+    pipe->carry = carry;
+    pipe->carrySize = size;
+  }
+  memcpy(pipe->carry + pipe->carryLen, bytes, len);
+  pipe->carryLen += len;
+  return 0;
+}
+
+/**
+ * Prepends the carried partial line to a freshly read chunk and carries its own trailing partial line forward
+ * NOTE: a line longer than the headroom is built up in the carry buffer, which is then handed over to the slot
+ * @param StrPipe*: pipeline
+ * @param StrPipeSlot*: slot just read
+ * @param size_t: amount of bytes read
+ * @param int: 1 if this is the last chunk of the input
+ * @returns int: 0 on success
+**/
+
+static int readerPrepare(StrPipe* pipe, StrPipeSlot* slot, size_t n, int last) {
+
+  char* chunk = slot->buf + pipe->headroom;
+  //Everything past the last newline belongs to the first line of the next chunk
+  char* nl = last ? NULL : lastNewline(chunk, n);
+  size_t keep = last ? n : (nl == NULL ? 0 : (size_t)(nl - chunk) + 1);
+  if (!last && nl == NULL) {
+    //No line ends in this chunk: the slot goes on empty
+    slot->data = chunk;
+    slot->len = 0;
+    return carryAppend(pipe, chunk, n);
+  }
+  if (pipe->carryLen <= pipe->headroom) {
+    slot->data = chunk - pipe->carryLen;
+    if (pipe->carryLen > 0) {
+      memcpy(slot->data, pipe->carry, pipe->carryLen);
+    }
+    slot->len = pipe->carryLen + keep;
+    pipe->carryLen = 0;
+  } else {
+    if (carryAppend(pipe, chunk, keep) != 0) {
+      return 1;
+    }
+    slot->spill = pipe->carry;
+    slot->data = slot->spill;
+    slot->len = pipe->carryLen;
+    pipe->carry = NULL;
+    pipe->carryLen = 0;
+    pipe->carrySize = 0;
+  }
+  return carryAppend(pipe, chunk + keep, n - keep);
+}
+
+/**
+ * Reader stage: keeps a read in flight for every free slot, publishing chunks in input order
+ * @param void*: pipeline
+**/
+
+static void* readerThread(void* arg) {
+
+  StrPipe* pipe = (StrPipe*)arg;
+  size_t nextSubmit = 0;
+  size_t nextComplete = 0;
+  int stop = 0;
+  size_t window = 1;
+#ifdef HAVE_LIBURING
+  if (pipe->useUring) {
+    window = pipe->depth;
+  }
+#endif
+
+  for (;;) {
+    //Submit reads into every slot the writer has released
+    while (!stop && nextSubmit - nextComplete < window) {
+      StrPipeSlot* slot = &pipe->slots[nextSubmit % pipe->depth];
+      int busy = 0;
+      pthread_mutex_lock(&pipe->lock);
+      //Backpressure: wait for the writer only when there are no reads in flight to publish meanwhile
+      while (slot->state != SLOT_FREE && pipe->error == 0 && nextSubmit == nextComplete) {
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+      }
+      if (pipe->error != 0) {
+        stop = 1;
+      } else if (slot->state != SLOT_FREE) {
+        busy = 1;
+      } else {
+        slot->state = SLOT_READING;
+        slot->seq = nextSubmit;
+      }
+      pthread_mutex_unlock(&pipe->lock);
+      if (stop || busy) {
+        break;
+      }
+      if (readerSubmit(pipe, slot) != 0) {
+        setError(pipe, errno);
+        pthread_mutex_lock(&pipe->lock);
+        slot->state = SLOT_FREE;
+        pthread_mutex_unlock(&pipe->lock);
+        stop = 1;
+        break;
+      }
+      nextSubmit++;
+    }
+    if (nextComplete == nextSubmit) {
+      break;
+    }
+
+    StrPipeSlot* slot = &pipe->slots[nextComplete % pipe->depth];
+    ssize_t n = readerComplete(pipe, slot);
+    nextComplete++;
+    if (n < 0) {
+      setError(pipe, errno);
+      stop = 1;
+    }
+    //Reads past the end of input (or after an error) are only reaped
+    if (stop) {
+      pthread_mutex_lock(&pipe->lock);
+      slot->state = SLOT_FREE;
+      pthread_mutex_unlock(&pipe->lock);
+      continue;
+    }
+    int last = (size_t)n < pipe->chunkSize;
+    if (readerPrepare(pipe, slot, n, last) != 0) {
+      setError(pipe, errno);
+      stop = 1;
+      pthread_mutex_lock(&pipe->lock);
+      releaseSlot(slot);
+      pthread_mutex_unlock(&pipe->lock);
+      continue;
+    }
+    pthread_mutex_lock(&pipe->lock);
+    slot->state = SLOT_READ;
+    pipe->published = slot->seq + 1;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+    stop = last;
+  }
+
+  pthread_mutex_lock(&pipe->lock);
+  pipe->readDone = 1;
+  pthread_cond_broadcast(&pipe->cond);
+  pthread_mutex_unlock(&pipe->lock);
+  return NULL;
+}
+
+/**
+ * Appends a buffer to the slot output
+ * @param StrPipeSlot*: slot
+ * @param char*: buffer to write
+ * @param size_t: length of buffer
+ * @returns int: 0 on success
+**/
+
+static int pushIov(StrPipeSlot* slot, char* base, size_t len) {
+
+  if (slot->iovCount == slot->iovSize) {
+    size_t size = slot->iovSize == 0 ? 64 : slot->iovSize * 2;
+    struct iovec* iov = (struct iovec*)realloc(slot->iov, sizeof(struct iovec) * size);
+    if (iov == NULL) {
+      errno = ENOMEM;
+      return 1;
+    }
+    slot->iov = iov;
+    slot->iovSize = size;
+  }
+  slot->iov[slot->iovCount].iov_base = base;
+  slot->iov[slot->iovCount].iov_len = len;
+  slot->iovCount++;
+  return 0;
+}
+
+/**
+ * Takes ownership of a line reallocated by the stages, so that it's freed once written
+ * @param StrPipeSlot*: slot
+ * @param char*: line
+ * @returns int: 0 on success
+**/
+
+static int pushLine(StrPipeSlot* slot, char* line) {
+
+  if (slot->lineCount == slot->lineSize) {
+    size_t size = slot->lineSize == 0 ? 64 : slot->lineSize * 2;
+    char** lines = (char**)realloc(slot->lines, sizeof(char*) * size);
+    if (lines == NULL) {
+      errno = ENOMEM;
+      return 1;
+    }
+    slot->lines = lines;
+    slot->lineSize = size;
+  }
+  slot->lines[slot->lineCount++] = line;
+  return 0;
+}
+
+/**
+ * Applies every stage to each line of the slot.
+ * Lines touched only by STRPIPE_INPLACE stages stay in the read buffer and are written from there
+ * in contiguous runs; a line is copied out of it only when the first reallocating stage needs it
+ * @param StrPipe*: pipeline
+ * @param StrPipeSlot*: slot to transform
+ * @returns int: 0 on success; errno is set otherwise
+**/
+
+static int transformChunk(StrPipe* pipe, StrPipeSlot* slot) {
+
+  char* ptr = slot->data;
+  char* end = slot->data + slot->len;
+  char* run = ptr; //Start of the lines, still in the read buffer, not yet queued for write
+  while (ptr < end) {
+    char* nl = (char*)memchr(ptr, '\n', end - ptr);
+    char* lineEnd = nl == NULL ? end : nl;
+    *lineEnd = 0x00;
+    char* line = ptr;
+    int owned = 0;
+    for (int i = 0; i < pipe->stageCount; i++) {
+      StrPipeStage* stage = &pipe->stages[i];
+      if (!owned && !(stage->flags & STRPIPE_INPLACE)) {
+        size_t lineLength = lineEnd - ptr;
+        line = (char*)malloc(sizeof(char) * (lineLength + 1));
+        if (line == NULL) {
+          errno = ENOMEM;
+          return 1;
+        }
+        memcpy(line, ptr, lineLength + 1);
+        owned = 1;
+      }
+      errno = 0;
+      if (stage->fn(&line, stage->arg) != 0) {
+        int error = errno != 0 ? errno : ECANCELED;
+        if (owned) {
+          free(line);
+        }
+        errno = error;
+        return 1;
+      }
+    }
+    if (!owned) {
+      if (nl != NULL) {
+        *nl = '\n';
+      }
+      ptr = nl == NULL ? end : nl + 1;
+      continue;
+    }
+    if (pushLine(slot, line) != 0) {
+      free(line);
+      return 1;
+    }
+    //Flush the run of untouched lines before this one
+    if (ptr > run && pushIov(slot, run, ptr - run) != 0) {
+      return 1;
+    }
+    if (pushIov(slot, line, strlen(line)) != 0) {
+      return 1;
+    }
+    if (nl != NULL && pushIov(slot, newline, 1) != 0) {
+      return 1;
+    }
+    ptr = nl == NULL ? end : nl + 1;
+    run = ptr;
+  }
+  if (end > run && pushIov(slot, run, end - run) != 0) {
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Transform stage: takes published chunks in order and applies the stages to them
+ * @param void*: pipeline
+**/
+
+static void* workerThread(void* arg) {
+
+  StrPipe* pipe = (StrPipe*)arg;
+  for (;;) {
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->nextTransform >= pipe->published && !pipe->readDone && pipe->error == 0) {
+      pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+    if (pipe->error != 0 || pipe->nextTransform >= pipe->published) {
+      pthread_mutex_unlock(&pipe->lock);
+      break;
+    }
+    StrPipeSlot* slot = &pipe->slots[pipe->nextTransform % pipe->depth];
+    pipe->nextTransform++;
+    slot->state = SLOT_TRANSFORMING;
+    pthread_mutex_unlock(&pipe->lock);
+
+    if (transformChunk(pipe, slot) != 0) {
+      setError(pipe, errno);
+      break;
+    }
+    pthread_mutex_lock(&pipe->lock);
+    slot->state = SLOT_DONE;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+  }
+  return NULL;
+}
+
+/**
+ * Writes the output of a slot, IOV_MAX buffers at a time
+ * @param StrPipe*: pipeline
+ * @param StrPipeSlot*: slot to write
+ * @returns int: 0 on success
+**/
+
+static int writeChunk(StrPipe* pipe, StrPipeSlot* slot) {
+
+  struct iovec* iov = slot->iov;
+  size_t left = slot->iovCount;
+  while (left > 0) {
+    ssize_t n = writev(pipe->outfd, iov, left > IOV_MAX ? IOV_MAX : (int)left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return 1;
+    }
+    //Skip what has been written, resuming a partially written buffer
+    while (left > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      left--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char*)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Streams infd to outfd, applying the pipeline stages to each line.
+ * Reading, transforming and writing run concurrently over the ring of chunks;
+ * output order is the input order. Seekable inputs are read with io_uring when available, with pread otherwise
+ * NOTE: infd is read from its current offset, which is left untouched if the input is seekable
+ * @param StrPipe*: pipeline
+ * @param int: input file descriptor
+ * @param int: output file descriptor
+ * @returns int: 0 on success. -1 in case of error, errno is set
+**/
+
+int strpipeRun(StrPipe* pipe, int infd, int outfd) {
+
+  pipe->infd = infd;
+  pipe->outfd = outfd;
+  pipe->base = lseek(infd, 0, SEEK_CUR);
+  pipe->seekable = pipe->base >= 0;
+  if (!pipe->seekable) {
+    pipe->base = 0;
+  }
+  pipe->published = 0;
+  pipe->nextTransform = 0;
+  pipe->readDone = 0;
+  pipe->error = 0;
+  pipe->carryLen = 0;
+
+  pthread_t reader;
+  pthread_t* workers = (pthread_t*)malloc(sizeof(pthread_t) * pipe->workers);
+  if (workers == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+#ifdef HAVE_LIBURING
+  //Reads at fixed offsets can be in flight together only if the input is seekable
+  pipe->useUring = pipe->seekable && io_uring_queue_init(pipe->depth, &pipe->ring, 0) == 0;
+#endif
+  int rc = pthread_create(&reader, NULL, readerThread, pipe);
+  int readerStarted = rc == 0;
+  int workersStarted = 0;
+  if (rc != 0) {
+    setError(pipe, rc);
+  }
+  while (rc == 0 && workersStarted < pipe->workers) {
+    rc = pthread_create(&workers[workersStarted], NULL, workerThread, pipe);
+    if (rc != 0) {
+      setError(pipe, rc);
+    } else {
+      workersStarted++;
+    }
+  }
+
+  //Write stage runs in the caller thread, draining chunks in input order
+  for (size_t seq = 0; readerStarted; seq++) {
+    StrPipeSlot* slot = &pipe->slots[seq % pipe->depth];
+    pthread_mutex_lock(&pipe->lock);
+    while (pipe->error == 0 && !(seq < pipe->published && slot->state == SLOT_DONE) && !(pipe->readDone && seq >= pipe->published)) {
+      pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+    if (pipe->error != 0 || seq >= pipe->published) {
+      pthread_mutex_unlock(&pipe->lock);
+      break;
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    if (writeChunk(pipe, slot) != 0) {
+      setError(pipe, errno);
+      break;
+    }
+    pthread_mutex_lock(&pipe->lock);
+    releaseSlot(slot);
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+  }
+
+  if (readerStarted) {
+    pthread_join(reader, NULL);
+  }
+  for (int i = 0; i < workersStarted; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+  //Chunks left behind by an error
+  for (int i = 0; i < pipe->depth; i++) {
+    releaseSlot(&pipe->slots[i]);
+  }
+#ifdef HAVE_LIBURING
+  if (pipe->useUring) {
+    io_uring_queue_exit(&pipe->ring);
+  }
+#endif
+
+  if (pipe->error != 0) {
+    errno = pipe->error;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Stage: converts the line to lower case (STRPIPE_INPLACE)
+ * @param char**: line
+ * @param void*: unused
+ * @returns int: 0
+**/
+
+int strpipeLowerCase(char** line, void* arg) {
+  (void)arg;
+  toLowerCase(*line);
+  return 0;
+}
+
+/**
+ * Stage: converts the line to upper case (STRPIPE_INPLACE)
+ * @param char**: line
+ * @param void*: unused
+ * @returns int: 0
+**/
+
+int strpipeUpperCase(char** line, void* arg) {
+  (void)arg;
+  toUpperCase(*line);
+  return 0;
+}
+
+/**
+ * Stage: removes leading and trailing whitespaces from the line
+ * @param char**: line, will be reallocated
+ * @param void*: unused
+ * @returns int: 0
+**/
+
+int strpipeTrim(char** line, void* arg) {
+  (void)arg;
+  *line = trim(*line);
+  return 0;
+}
+
+/**
+ * Stage: replaces all the occurrences of oldStr with newStr in the line
+ * NOTE: newStr must not contain oldStr
+ * @param char**: line, will be reallocated
+ * @param void*: StrPipeReplace*
+ * @returns int: 0 on success
+**/
+
+int strpipeReplaceAll(char** line, void* arg) {
+
+  StrPipeReplace* replacement = (StrPipeReplace*)arg;
+  if (*replacement->oldStr == 0x00) {
+    return 0;
+  }
+  //Same as replaceAll, but keeping the last valid line if a reallocation fails
+  while (indexOf(*line, replacement->oldStr) != -1) {
+    char* replaced = replace(*line, replacement->oldStr, replacement->newStr);
+    if (replaced == NULL) {
+      errno = ENOMEM;
+      return 1;
+    }
+    *line = replaced;
+  }
+  return 0;
+}
+
+/**
+ * Stage: splits the line on splitDelimiter and joins back its tokens with joinDelimiter
+ * NOTE: as in strsplit, a trailing splitDelimiter doesn't make an empty last token
+ * @param char**: line, will be replaced
+ * @param void*: StrPipeSplitJoin*
+ * @returns int: 0 on success
+**/
+
+int strpipeSplitJoin(char** line, void* arg) {
+
+  StrPipeSplitJoin* delimiters = (StrPipeSplitJoin*)arg;
+  if (**line == 0x00 || *delimiters->splitDelimiter == 0x00) {
+    return 0;
+  }
+  int tokenCount;
+  char** tokens = strsplit(&tokenCount, *line, delimiters->splitDelimiter);
+  if (tokens == NULL) {
+    errno = ENOMEM;
+    return 1;
+  }
+  char* joined = strjoin(tokens, tokenCount, delimiters->joinDelimiter);
+  for (int i = 0; i < tokenCount; i++) {
+    free(*(tokens + i));
+  }
+  free(tokens);
+  if (joined == NULL) {
+    errno = ENOMEM;
+    return 1;
+  }
+  free(*line);
+  *line = joined;
+  return 0;
+}
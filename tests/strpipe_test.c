@@ -0,0 +1,247 @@
+/**
+ *   stringEXT - string.h extended
+ *   Developed by Christian Visintin
+ *
+ * MIT License
+ * Copyright (c) 2018 Christian Visintin
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+**/
+
+#define _GNU_SOURCE
+
+#include "strpipe.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHUNK_SIZE 4096
+
+static int failures = 0;
+
+typedef struct PipeFeed {
+  int fd;
+  char* data;
+  size_t len;
+} PipeFeed;
+
+/**
+ * Creates an unlinked temporary file
+ * @param char*: content of the file
+ * @param size_t: length of content
+ * @returns int: file descriptor positioned at the beginning of the file
+**/
+
+static int tempFile(char* content, size_t len) {
+  char path[] = "/tmp/strpipe_testXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    perror("mkstemp");
+    exit(1);
+  }
+  unlink(path);
+  if (len > 0 && write(fd, content, len) != (ssize_t)len) {
+    perror("write");
+    exit(1);
+  }
+  lseek(fd, 0, SEEK_SET);
+  return fd;
+}
+
+/**
+ * Writes the whole feed into a pipe, then closes it
+ * @param void*: PipeFeed*
+**/
+
+static void* feedPipe(void* arg) {
+  PipeFeed* feed = (PipeFeed*)arg;
+  size_t written = 0;
+  while (written < feed->len) {
+    ssize_t n = write(feed->fd, feed->data + written, feed->len - written);
+    if (n <= 0) {
+      break;
+    }
+    written += n;
+  }
+  close(feed->fd);
+  return NULL;
+}
+
+/**
+ * Runs pipe over input and compares its output with expected
+ * @param char*: test name
+ * @param StrPipe*: pipeline
+ * @param char*: input
+ * @param char*: expected output
+ * @param int: 1 to feed the input through a pipe instead of a file
+**/
+
+static void check(char* name, StrPipe* pipe, char* input, char* expected, int usePipe) {
+
+  size_t inputLength = strlen(input);
+  int outfd = tempFile(NULL, 0);
+  int rc;
+  if (usePipe) {
+    int fds[2];
+    if (pipe2(fds, 0) != 0) {
+      perror("pipe");
+      exit(1);
+    }
+    PipeFeed feed = { fds[1], input, inputLength };
+    pthread_t feeder;
+    pthread_create(&feeder, NULL, feedPipe, &feed);
+    rc = strpipeRun(pipe, fds[0], outfd);
+    pthread_join(feeder, NULL);
+    close(fds[0]);
+  } else {
+    int infd = tempFile(input, inputLength);
+    rc = strpipeRun(pipe, infd, outfd);
+    close(infd);
+  }
+
+  size_t expectedLength = strlen(expected);
+  off_t outputLength = lseek(outfd, 0, SEEK_END);
+  char* output = (char*)malloc(sizeof(char) * (outputLength + 1));
+  ssize_t n = pread(outfd, output, outputLength, 0);
+  close(outfd);
+  if (rc != 0 || n != outputLength || (size_t)outputLength != expectedLength || memcmp(output, expected, expectedLength) != 0) {
+    printf("FAIL: %s (rc %d, output %ld bytes, expected %lu bytes)\n", name, rc, (long)outputLength, (unsigned long)expectedLength);
+    failures++;
+  } else {
+    printf("PASS: %s\n", name);
+  }
+  free(output);
+}
+
+/**
+ * Builds lines of increasing length, so that lines straddle chunk boundaries at every offset
+ * @param int: amount of lines
+ * @param int: 1 to end the last line with a newline
+ * @returns char*: the text
+**/
+
+static char* makeLines(int lineCount, int trailingNewline) {
+  size_t size = 1;
+  for (int i = 0; i < lineCount; i++) {
+    size += i % 300 + 1;
+  }
+  char* text = (char*)malloc(sizeof(char) * size);
+  char* ptr = text;
+  for (int i = 0; i < lineCount; i++) {
+    for (int j = 0; j < i % 300; j++) {
+      *(ptr++) = "aBc dEf"[(i + j) % 7];
+    }
+    *(ptr++) = '\n';
+  }
+  if (!trailingNewline) {
+    ptr--;
+  }
+  *ptr = 0x00;
+  return text;
+}
+
+/**
+ * Returns a copy of text in upper case
+ * @param char*: text
+ * @returns char*: new string
+**/
+
+static char* upper(char* text) {
+  char* copy = strdup(text);
+  for (char* ptr = copy; *ptr != 0x00; ptr++) {
+    *ptr = toupper((unsigned char)*ptr);
+  }
+  return copy;
+}
+
+static int failOnMarker(char** line, void* arg) {
+  (void)arg;
+  if (strstr(*line, "FAIL") != NULL) {
+    errno = EINVAL;
+    return 1;
+  }
+  return 0;
+}
+
+int main(void) {
+
+  StrPipe* pipe = strpipeCreate(CHUNK_SIZE, 4, 3);
+  strpipeAddStage(pipe, strpipeUpperCase, NULL, STRPIPE_INPLACE);
+
+  char* lines = makeLines(2000, 1);
+  char* expected = upper(lines);
+  check("chunk boundary carry", pipe, lines, expected, 0);
+  check("chunk boundary carry from a pipe", pipe, lines, expected, 1);
+  free(lines);
+  free(expected);
+
+  lines = makeLines(2000, 0);
+  expected = upper(lines);
+  check("no trailing newline", pipe, lines, expected, 0);
+  check("no trailing newline from a pipe", pipe, lines, expected, 1);
+  free(lines);
+  free(expected);
+
+  //A line spanning many chunks, past the headroom
+  size_t longLength = CHUNK_SIZE * 10 + 123;
+  lines = (char*)malloc(sizeof(char) * (longLength + 32));
+  strcpy(lines, "first\n");
+  memset(lines + 6, 'x', longLength);
+  strcpy(lines + 6 + longLength, "\nlast\n");
+  expected = upper(lines);
+  check("line longer than a chunk", pipe, lines, expected, 0);
+  check("line longer than a chunk from a pipe", pipe, lines, expected, 1);
+  free(lines);
+  free(expected);
+
+  check("empty input", pipe, "", "", 0);
+  strpipeDestroy(pipe);
+
+  //Reallocating stages
+  StrPipeReplace replacement = { "foo", "bar" };
+  StrPipeSplitJoin delimiters = { "::", ";" };
+  pipe = strpipeCreate(CHUNK_SIZE, 0, 2);
+  strpipeAddStage(pipe, strpipeLowerCase, NULL, STRPIPE_INPLACE);
+  strpipeAddStage(pipe, strpipeReplaceAll, &replacement, 0);
+  strpipeAddStage(pipe, strpipeTrim, NULL, 0);
+  strpipeAddStage(pipe, strpipeSplitJoin, &delimiters, 0);
+  check("reallocating stages", pipe, "  FOO::b  \nkeep\n\n   \na::::b\nfoo", "bar;b\nkeep\n\n\na;;b\nbar", 0);
+  strpipeDestroy(pipe);
+
+  //Failing stage
+  pipe = strpipeCreate(CHUNK_SIZE, 0, 2);
+  strpipeAddStage(pipe, strpipeTrim, NULL, 0);
+  strpipeAddStage(pipe, failOnMarker, NULL, 0);
+  int infd = tempFile("ok\n FAIL \nok\n", 13);
+  int outfd = tempFile(NULL, 0);
+  errno = 0;
+  if (strpipeRun(pipe, infd, outfd) != -1 || errno != EINVAL) {
+    printf("FAIL: failing stage (errno %d)\n", errno);
+    failures++;
+  } else {
+    printf("PASS: failing stage\n");
+  }
+  close(infd);
+  close(outfd);
+  strpipeDestroy(pipe);
+
+  return failures == 0 ? 0 : 1;
+}